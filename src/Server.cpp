@@ -1,11 +1,31 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
 #include <sstream>
 #include <string>
-
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <zlib.h>
+#include "git_index.hpp"
+#include "object_kind.hpp"
 #include "sha1.hpp"
+#include "sha1_multi.hpp"
+#include "worktree_walk.hpp"
 
 
 
@@ -23,14 +43,17 @@ std::string readFileToString(const std::string& fileName) {
     return buffer.str();
 }
 
-void writeStringToFile(const std::string& fileName, const std::string& out_str) {
-    std::ofstream file(fileName, std::ios::out | std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open object file for writing: " + fileName);
+void writeBufferToFd(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error("Failed to write output: " + std::string(std::strerror(errno)));
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
     }
-
-    file.write(out_str.data(), out_str.size());
-    file.close();
 }
 
 void compressString(const std::string& uncompressed, std::string& compressed) {
@@ -73,10 +96,188 @@ void uncompressString(const std::string& compressed, std::string& uncompressed,
     delete [] uncompressedData;
 }
 
+// Writes loose objects from many threads and processes at once.
+//
+// Work is sharded by fanout directory (the first two hex digits of the hash).
+// Each shard has a lock-free open-addressing table of the object ids this
+// process is writing or has written, so two threads never compress the same
+// object; a thread that finds the id in flight waits for the owner instead.
+// Across processes, objects are written to a private temporary file and
+// published with link(2), which fails with EEXIST rather than replacing an
+// object, so readers never see a partially written file.
+class ObjectWriter {
+public:
+    static ObjectWriter& instance(void) {
+        static ObjectWriter writer;
+        return writer;
+    }
+
+    ~ObjectWriter() {
+        for (Shard& shard : shards) {
+            std::atomic<Claim*>* slots = shard.slots.load();
+            if (slots == nullptr)
+                continue;
+            for (size_t i = 0; i < SHARD_SLOTS; i++)
+                delete slots[i].load();
+            delete [] slots;
+        }
+    }
+
+    void write(const std::string& objectSHA, const std::string& objectContent) {
+        Shard& shard = shards[std::stoul(objectSHA.substr(0, 2), nullptr, 16)];
+        Claim* claimed = claim(shard, objectSHA);
+        if (claimed == nullptr) {
+            // Table full: skip in-process dedup, publication is still safe
+            publish(shard, objectSHA, objectContent);
+            return;
+        }
+
+        int state = claimed->state.load(std::memory_order_acquire);
+        while (true) {
+            if (state == WRITTEN)
+                return;
+
+            if (state == IN_FLIGHT) {
+                claimed->state.wait(IN_FLIGHT, std::memory_order_acquire);
+                state = claimed->state.load(std::memory_order_acquire);
+                continue;
+            }
+
+            // IDLE: nobody has written it yet, or the last attempt failed
+            if (claimed->state.compare_exchange_weak(state, IN_FLIGHT, std::memory_order_acq_rel))
+                break;
+        }
+
+        try {
+            publish(shard, objectSHA, objectContent);
+        } catch (...) {
+            claimed->state.store(IDLE, std::memory_order_release);
+            claimed->state.notify_all();
+            throw;
+        }
+        claimed->state.store(WRITTEN, std::memory_order_release);
+        claimed->state.notify_all();
+    }
+
+private:
+    enum ClaimState : int { IDLE, IN_FLIGHT, WRITTEN };
+
+    struct Claim {
+        std::string objectSHA;
+        std::atomic<int> state{IDLE};
+    };
+
+    static constexpr size_t SHARD_COUNT = 256;
+    static constexpr size_t SHARD_SLOTS = 4096;
+
+    struct Shard {
+        std::atomic<bool> directoryReady{false};
+        std::atomic<std::atomic<Claim*>*> slots{nullptr};   // Allocated on first use
+    };
+
+    Shard shards[SHARD_COUNT];
+
+    ObjectWriter() = default;
+
+    // Find or insert the claim for the object id, or nullptr if the shard is full
+    Claim* claim(Shard& shard, const std::string& objectSHA) {
+        std::atomic<Claim*>* slots = shard.slots.load(std::memory_order_acquire);
+        if (slots == nullptr) {
+            std::atomic<Claim*>* fresh = new std::atomic<Claim*>[SHARD_SLOTS]();
+            if (shard.slots.compare_exchange_strong(slots, fresh, std::memory_order_acq_rel))
+                slots = fresh;
+            else
+                delete [] fresh;
+        }
+
+        // The digits after the fanout are uniformly distributed already
+        size_t start = std::stoul(objectSHA.substr(2, 8), nullptr, 16) % SHARD_SLOTS;
+        Claim* mine = nullptr;
+        for (size_t probe = 0; probe < SHARD_SLOTS; probe++) {
+            std::atomic<Claim*>& slot = slots[(start + probe) % SHARD_SLOTS];
+            Claim* existing = slot.load(std::memory_order_acquire);
+            if (existing == nullptr) {
+                if (mine == nullptr)
+                    mine = new Claim{objectSHA};
+                if (slot.compare_exchange_strong(existing, mine, std::memory_order_acq_rel))
+                    return mine;
+            }
+            if (existing->objectSHA == objectSHA) {
+                delete mine;
+                return existing;
+            }
+        }
+
+        delete mine;
+        return nullptr;
+    }
+
+    void publish(Shard& shard, const std::string& objectSHA, const std::string& objectContent) {
+        // 40 character SHA1 hash. First two characters are object directory name
+        // Last 38 character is the object file name
+        std::string objectDirName = ".git/objects/" + objectSHA.substr(0, 2);
+        std::string objectPath = objectDirName + "/" + objectSHA.substr(2);
+
+        // Objects are immutable: one published by another process is final
+        if (access(objectPath.c_str(), F_OK) == 0)
+            return;
+
+        if (!shard.directoryReady.load(std::memory_order_acquire)) {
+            if (mkdir(objectDirName.c_str(), 0777) != 0 && errno != EEXIST)
+                throw std::runtime_error("Couldn't create directory " + objectDirName + ": " +
+                                         std::strerror(errno));
+            shard.directoryReady.store(true, std::memory_order_release);
+        }
+
+        std::string compressedObject;
+        compressString(objectContent, compressedObject);
+
+        // O_EXCL temporary file, unique to this writer
+        std::string tempPath = objectDirName + "/tmp_obj_XXXXXX";
+        int fd = mkstemp(tempPath.data());
+        if (fd < 0)
+            throw std::runtime_error("Failed to open object file for writing: " + tempPath);
+
+        try {
+            writeBufferToFd(fd, compressedObject.data(), compressedObject.size());
+        } catch (...) {
+            close(fd);
+            unlink(tempPath.c_str());
+            throw;
+        }
+        if (fchmod(fd, 0444) != 0) {
+            int error = errno;
+            close(fd);
+            unlink(tempPath.c_str());
+            throw std::runtime_error("Failed to set permissions of " + tempPath + ": " + std::strerror(error));
+        }
+        if (close(fd) != 0) {
+            unlink(tempPath.c_str());
+            throw std::runtime_error("Failed to write object file: " + tempPath);
+        }
+
+        // EEXIST means another writer published the same object first
+        if (link(tempPath.c_str(), objectPath.c_str()) == 0 || errno == EEXIST) {
+            unlink(tempPath.c_str());
+            return;
+        }
+
+        // Filesystems without hard links: rename is still atomic
+        if (rename(tempPath.c_str(), objectPath.c_str()) != 0) {
+            int error = errno;
+            unlink(tempPath.c_str());
+            throw std::runtime_error("Failed to publish object " + objectSHA + ": " + std::strerror(error));
+        }
+    }
+};
+
 class GitObjectUtility {
 public:
     std::string objectSHA;
-    std::string objectType;
+    ObjectHeader header{};
+
+    // Inflate output buffer size for streamed reads
+    static constexpr size_t STREAM_CHUNK_BYTES = 1 << 20;
 
     GitObjectUtility(std::string sha1) : objectSHA(sha1) {}
 
@@ -108,38 +309,117 @@ public:
             throw;
         }
 
-        // Find the type of the object and handle type error
-        size_t firstSpace = uncompressedObject.find(' ');
-        objectType = uncompressedObject.substr(0, firstSpace);
-        if (objectType != "tree" && objectType != "blob")
-            throw std::runtime_error("fatal error: Invalid object type");
+        // Parse the type and size of the object once and handle type error
+        header = parseObjectHeader(uncompressedObject);
+        if (header.size != uncompressedObject.size() - header.bodyOffset)
+            throw std::runtime_error("Invalid git object format: size mismatch");
 
         return uncompressedObject;
     }
 
-    std::string createObjectDirectory(const std::string objectSHA) {
-        // 40 character SHA1 hash. First two characters are object directory name
-        // Last 38 character is the object file name
-        std::string objectDirName = ".git/objects/" + objectSHA.substr(0, 2);
-        std::string objectPath = objectDirName + "/" + objectSHA.substr(2);
-    
-        try {
-            std::filesystem::create_directory(objectDirName);
-        } catch (const std::filesystem::filesystem_error& e) {
-            std::cerr << "Couldn't create directory\n" << e.what() << std::endl;
-            throw;
+    // Receives the content of an object chunk by chunk
+    using ContentSink = std::function<void(const char* data, size_t size)>;
+
+    // Inflate the object file in fixed-size chunks. The header is parsed into
+    // `header` from the first chunk and makeSink(header) picks the sink that
+    // receives the content bytes, so memory use doesn't grow with the object.
+    template <class F>
+    void inflateObjectChunks(F makeSink) {
+        std::string objectFilePath = ".git/objects/" + objectSHA.substr(0, 2) + "/" + objectSHA.substr(2);
+
+        // Map the compressed file instead of reading it into a string
+        int fd = open(objectFilePath.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("fatal: Invalid object name " + objectSHA +
+                                        ". No such object in .git/object directory");
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            throw std::runtime_error("Invalid git object format: empty object file");
         }
 
-        return objectPath;
+        size_t mappedSize = static_cast<size_t>(st.st_size);
+        void* mapped = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+            throw std::runtime_error("Failed to map object file: " + objectFilePath);
+        madvise(mapped, mappedSize, MADV_SEQUENTIAL);
+
+        z_stream stream{};
+        if (inflateInit(&stream) != Z_OK) {
+            munmap(mapped, mappedSize);
+            throw std::runtime_error("Decompression Failed: couldn't initialise zlib");
+        }
+
+        // Releases the mapping and the zlib state on every exit path
+        struct InflateGuard {
+            z_stream& stream;
+            void* mapped;
+            size_t mappedSize;
+            ~InflateGuard() {
+                inflateEnd(&stream);
+                munmap(mapped, mappedSize);
+            }
+        } guard{stream, mapped, mappedSize};
+
+        std::unique_ptr<char[]> buffer(new char[STREAM_CHUNK_BYTES]);
+        const Bytef* input = static_cast<const Bytef*>(mapped);
+        size_t inputLeft = mappedSize;
+        size_t filled = 0;
+        size_t contentBytes = 0;
+        bool headerParsed = false;
+        ContentSink onContent;
+
+        int status = Z_OK;
+        while (status != Z_STREAM_END) {
+            // avail_in is 32 bit; feed files over 4 GiB in pieces
+            if (stream.avail_in == 0 && inputLeft > 0) {
+                stream.next_in = const_cast<Bytef*>(input);
+                stream.avail_in = static_cast<uInt>(std::min<size_t>(inputLeft, UINT_MAX));
+                input += stream.avail_in;
+                inputLeft -= stream.avail_in;
+            }
+
+            stream.next_out = reinterpret_cast<Bytef*>(buffer.get() + filled);
+            stream.avail_out = static_cast<uInt>(STREAM_CHUNK_BYTES - filled);
+            status = inflate(&stream, Z_NO_FLUSH);
+            if (status != Z_OK && status != Z_STREAM_END)
+                throw std::runtime_error("Decompression Failed with an error code: " + std::to_string(status));
+            filled = STREAM_CHUNK_BYTES - stream.avail_out;
+
+            size_t contentStart = 0;
+            if (!headerParsed) {
+                if (std::memchr(buffer.get(), '\0', filled) == nullptr) {
+                    if (status == Z_STREAM_END || filled == STREAM_CHUNK_BYTES)
+                        throw std::runtime_error("Invalid git object format: no null character found");
+                    continue;
+                }
+                header = parseObjectHeader(std::string_view(buffer.get(), filled));
+                headerParsed = true;
+                onContent = makeSink(header);
+                contentStart = header.bodyOffset;
+            }
+
+            if (filled > contentStart) {
+                onContent(buffer.get() + contentStart, filled - contentStart);
+                contentBytes += filled - contentStart;
+            }
+            filled = 0;
+        }
+
+        if (contentBytes != header.size)
+            throw std::runtime_error("Invalid git object format: size mismatch");
     }
 
     // Raw hex bytes to hex string
-    std::string toHex(const uint8_t* buffer, size_t length) {
-        std::ostringstream ostream;
+    static std::string toHex(const uint8_t* buffer, size_t length) {
+        static const char hexDigits[] = "0123456789abcdef";
+        std::string hexString(2 * length, '0');
         for (size_t i = 0; i < length; i++) {
-            ostream << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(buffer[i]);
+            hexString[2 * i] = hexDigits[buffer[i] >> 4];
+            hexString[2 * i + 1] = hexDigits[buffer[i] & 0xf];
         }
-        return ostream.str();
+        return hexString;
 
         /* Using C
         for (size_t i = 0; i < length; i++) {
@@ -148,6 +428,24 @@ public:
         printf("\n");
         */
     }
+
+    // Hex string to raw bytes
+    static std::string fromHex(const std::string& hexString) {
+        auto nibble = [](char c) {
+            return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+        };
+
+        std::string raw(hexString.size() / 2, '\0');
+        for (size_t i = 0; i < raw.size(); i++)
+            raw[i] = static_cast<char>(nibble(hexString[2 * i]) << 4 | nibble(hexString[2 * i + 1]));
+        return raw;
+    }
+
+    // Compress the object content and publish it in .git/objects. Safe to
+    // call from several threads and processes for the same object.
+    void writeObject(const std::string& objectContent) {
+        ObjectWriter::instance().write(objectSHA, objectContent);
+    }
 };
 
 class Blob {
@@ -155,72 +453,438 @@ private:
     std::string fileName;
 
 public:
+    // A file to store as a blob. A symbolic link is stored as the path it
+    // points to rather than the content of its target.
+    struct BlobFile {
+        std::string path;
+        bool symlink;
+    };
+
+    // Files are read, hashed and written in batches of this many
+    static constexpr size_t HASH_BATCH_FILES = 256;
+
+    // Read size for files hashed as a stream
+    static constexpr size_t STREAM_BLOCK_BYTES = 64 * 1024;
+
     Blob(std::string fileName): fileName(fileName) {}
 
-    void createBlobObject(void) {
-        // Read file content
+    // Blob hash of a file, read in blocks rather than loaded whole. The
+    // header size comes from fstat on the descriptor being read, and exactly
+    // that many bytes are hashed, so a file changing underneath can't give a
+    // header that disagrees with the content.
+    static std::string hashFileStream(const std::string& fileName) {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("fatal: Failed to open '" + fileName + "' for reading");
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("fatal: Couldn't stat '" + fileName + "'");
+        }
+
+        SHA1 hash;
+        size_t remaining = static_cast<size_t>(st.st_size);
+        hash.update(objectHeader<ObjectKind::Blob>(remaining));
+
+        std::string block(STREAM_BLOCK_BYTES, '\0');
+        while (remaining > 0) {
+            ssize_t bytesRead = read(fd, block.data(), std::min(remaining, block.size()));
+            if (bytesRead < 0 && errno == EINTR)
+                continue;
+            if (bytesRead <= 0) {
+                close(fd);
+                throw std::runtime_error("fatal: Short read of '" + fileName + "', file changed while hashing");
+            }
+            hash.update(block.substr(0, static_cast<size_t>(bytesRead)));
+            remaining -= static_cast<size_t>(bytesRead);
+        }
+        close(fd);
+        return hash.final();
+    }
+
+    // Header and content of the blob object for the file
+    std::string blobObjectContent(void) {
         std::string fileContent;
         try {
             fileContent = readFileToString(fileName);
         } catch (std::runtime_error& e) {
             std::cerr << "fatal: ";
             throw;
-        } catch (std::exception& e) {
-            throw;
         }
 
-        // Create header and blob object file content
-        std::string header = "blob " + std::to_string(fileContent.size()) + '\0';
-        std::string blobContent = header + fileContent;
+        return objectHeader<ObjectKind::Blob>(fileContent.size()) + fileContent;
+    }
+
+    // Hash the blobs of all files and, if write is set, store them in the
+    // object store. One thread pool works through the list in fixed-size
+    // batches; each batch is hashed in the multi-buffer SHA1's parallel lanes.
+    // When only hashing, files above SHA1_MULTI_MAX_BYTES are streamed through
+    // the serial SHA1 instead of being read whole, so a batch holds at most
+    // HASH_BATCH_FILES small files however large the tree is.
+    // Returns the SHA1 hashes in input order.
+    static std::vector<std::string> hashBlobFiles(const std::vector<BlobFile>& files, bool write) {
+        std::vector<std::string> hashStrings(files.size());
+        size_t batches = (files.size() + HASH_BATCH_FILES - 1) / HASH_BATCH_FILES;
+
+        parallelFor(batches, defaultWalkThreads(), [&](size_t batch) {
+            size_t begin = batch * HASH_BATCH_FILES;
+            size_t end = std::min(begin + HASH_BATCH_FILES, files.size());
+
+            std::vector<size_t> batchFiles;
+            std::vector<std::string> blobContents;
+            for (size_t i = begin; i < end; i++) {
+                if (files[i].symlink) {
+                    std::string target = std::filesystem::read_symlink(files[i].path).string();
+                    blobContents.push_back(objectHeader<ObjectKind::Blob>(target.size()) + target);
+                } else if (!write && std::filesystem::file_size(files[i].path) > SHA1_MULTI_MAX_BYTES) {
+                    hashStrings[i] = hashFileStream(files[i].path);
+                    continue;
+                } else {
+                    blobContents.push_back(Blob(files[i].path).blobObjectContent());
+                }
+                batchFiles.push_back(i);
+            }
+
+            std::vector<std::string_view> messages(blobContents.begin(), blobContents.end());
+            std::vector<std::string> batchHashes = sha1Many(messages);
+            for (size_t j = 0; j < batchFiles.size(); j++) {
+                if (write)
+                    GitObjectUtility(batchHashes[j]).writeObject(blobContents[j]);
+                hashStrings[batchFiles[j]] = std::move(batchHashes[j]);
+            }
+        });
+
+        return hashStrings;
+    }
+};
+
+class Tree {
+private:
+    std::string path;
+
+public:
+    struct TreeEntry {
+        std::string mode;
+        std::string name;
+        std::string hashString;
+    };
+
+private:
+    // A directory collected by the walk, before its blobs are hashed
+    struct PendingTree {
+        std::vector<std::pair<TreeEntry, size_t>> blobs;   // Entry and index into the file list
+        std::vector<std::pair<std::string, PendingTree>> subtrees;
+    };
+
+    static PendingTree collectTree(const std::string& directory, std::vector<Blob::BlobFile>& files) {
+        PendingTree pending;
+        for (const auto& dirEntry : std::filesystem::directory_iterator(directory)) {
+            std::string name = dirEntry.path().filename().string();
+            if (name == ".git")
+                continue;
+
+            std::filesystem::file_status status = dirEntry.symlink_status();
+            if (std::filesystem::is_directory(status)) {
+                pending.subtrees.emplace_back(name, collectTree(dirEntry.path().string(), files));
+            } else if (std::filesystem::is_symlink(status)) {
+                pending.blobs.push_back({{"120000", name, ""}, files.size()});
+                files.push_back({dirEntry.path().string(), true});
+            } else if (std::filesystem::is_regular_file(status)) {
+                bool executable = (status.permissions() & std::filesystem::perms::owner_exec)
+                                  != std::filesystem::perms::none;
+                pending.blobs.push_back({{executable ? "100755" : "100644", name, ""}, files.size()});
+                files.push_back({dirEntry.path().string(), false});
+            }
+        }
+        return pending;
+    }
+
+    // Write the trees bottom-up once every blob hash is known. Returns the
+    // tree's hash, or an empty string for a directory with no files.
+    static std::string writePendingTree(const PendingTree& pending, const std::vector<std::string>& blobHashes) {
+        std::vector<TreeEntry> entries;
+        for (const auto& [name, subtree] : pending.subtrees) {
+            std::string hashString = writePendingTree(subtree, blobHashes);
+            if (!hashString.empty())
+                entries.push_back({"40000", name, hashString});
+        }
+        for (const auto& [entry, fileIndex] : pending.blobs)
+            entries.push_back({entry.mode, entry.name, blobHashes[fileIndex]});
+
+        if (entries.empty())
+            return "";
+
+        std::string treeContent = treeObjectContent(entries);
 
-        // SHA1 calculation
         SHA1 hash;
-        hash.update(blobContent);
+        hash.update(treeContent);
         std::string hashString = hash.final();
 
         GitObjectUtility gitObjectUtility(hashString);
+        gitObjectUtility.writeObject(treeContent);
 
-        // Create object directory
-        std::string blobPath;
-        try {
-            blobPath = gitObjectUtility.createObjectDirectory(hashString);
-        } catch (std::filesystem::filesystem_error& e) {
-            throw;
-        } catch (std::exception& e) {
-            throw;
-        }
+        return hashString;
+    }
 
-        // Compress the blob file
-        std::string compressedBlob;
-        try {
-            compressString(blobContent, compressedBlob);
-        } catch (std::runtime_error& e) {
-            throw;
-        } catch (std::exception& e) {
-            throw;
-        }
+public:
+    Tree(std::string path) : path(path) {}
 
-        // Write the compressed string to object file
-        try {
-            writeStringToFile(blobPath, compressedBlob);
-        } catch (std::runtime_error& e) {
-            throw;
-        } catch (std::exception& e) {
-            throw;
+    // Sort the entries into git order and format the tree object with its header
+    static std::string treeObjectContent(std::vector<TreeEntry>& entries) {
+        // Git orders entries by name, comparing a directory as if it ended in '/'
+        std::sort(entries.begin(), entries.end(), [](const TreeEntry& x, const TreeEntry& y) {
+            std::string xKey = x.mode == "40000" ? x.name + '/' : x.name;
+            std::string yKey = y.mode == "40000" ? y.name + '/' : y.name;
+            return xKey < yKey;
+        });
+
+        std::string treeContent;
+        for (const TreeEntry& entry : entries) {
+            treeContent += entry.mode + ' ' + entry.name + '\0';
+            treeContent += GitObjectUtility::fromHex(entry.hashString);
         }
+        return objectHeader<ObjectKind::Tree>(treeContent.size()) + treeContent;
+    }
 
-        // Print out the SHA1 hash
-        std::cout << hashString << std::endl;
+    // Write the tree object for the directory and every blob and subtree below
+    // it. Returns its SHA1 hash, or an empty string for a directory with no files.
+    std::string createTreeObject(void) {
+        // Walk first, then hash and write every blob of the walk as one batch,
+        // so small directories share the SHA1 lanes and the thread pool
+        std::vector<Blob::BlobFile> files;
+        PendingTree root = collectTree(path, files);
+        std::vector<std::string> blobHashes = Blob::hashBlobFiles(files, true);
+        return writePendingTree(root, blobHashes);
     }
 };
 
-class Tree {
+
+// Compares the working directory against a tree object. Directories are
+// listed and lstat'ed in parallel, and a file is only hashed when its stat
+// data differs from the index and the base tree has a file of that name to
+// compare it with. Subtrees whose hash matches the base tree are skipped
+// without reading the base tree objects below them.
+class WorktreeStatus {
 private:
-    std::string path;
+    GitIndex index;
+    std::string baseTreeHash;
+    std::vector<WalkDirectory> walked;
+    std::unordered_map<std::string, const WalkDirectory*> directoriesByPath;
+    std::unordered_map<std::string, std::string> fileHashes;
+    std::unordered_map<std::string, std::vector<Tree::TreeEntry>> directoryEntries;
+    std::unordered_map<std::string, std::string> directoryHashes;   // Empty for a directory with no files
+    std::unordered_set<std::string> dirtyDirectories;               // Hold new files, left unhashed
+    std::unordered_map<std::string, std::vector<Tree::TreeEntry>> baseTrees;   // By tree hash
+    std::unordered_map<std::string, std::string> baseDirectoryHashes;          // By path, empty if absent
+    std::vector<std::string> changes;
+
+    static std::string joinPath(const std::string& directory, const std::string& name) {
+        return directory.empty() ? name : directory + "/" + name;
+    }
 
-public:
-    Tree(std::string path) : path(path) {}
+    // Tree entry mode of a non-directory, or nullptr for files git doesn't track
+    static const char* fileMode(const struct stat& st) {
+        if (S_ISLNK(st.st_mode))
+            return "120000";
+        if (S_ISREG(st.st_mode))
+            return (st.st_mode & S_IXUSR) ? "100755" : "100644";
+        return nullptr;
+    }
+
+    // Entries of a base tree object, read at most once
+    const std::vector<Tree::TreeEntry>& baseTreeEntries(const std::string& treeHash) {
+        auto cached = baseTrees.find(treeHash);
+        if (cached == baseTrees.end())
+            cached = baseTrees.emplace(treeHash, readTreeEntries(treeHash)).first;
+        return cached->second;
+    }
+
+    // Hash of the base tree's directory at path, or "" if the base has none
+    const std::string& baseDirectoryHash(const std::string& path) {
+        auto cached = baseDirectoryHashes.find(path);
+        if (cached != baseDirectoryHashes.end())
+            return cached->second;
+
+        std::string hashString;
+        if (path.empty()) {
+            hashString = baseTreeHash;
+        } else {
+            size_t slash = path.rfind('/');
+            std::string parentHash = baseDirectoryHash(slash == std::string::npos ? "" : path.substr(0, slash));
+            std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+            if (!parentHash.empty()) {
+                for (const Tree::TreeEntry& entry : baseTreeEntries(parentHash)) {
+                    if (entry.name == name && entry.mode == "40000")
+                        hashString = entry.hashString;
+                }
+            }
+        }
+        return baseDirectoryHashes[path] = hashString;
+    }
+
+    void markDirty(std::string path) {
+        while (dirtyDirectories.insert(path).second && !path.empty()) {
+            size_t slash = path.rfind('/');
+            path = slash == std::string::npos ? "" : path.substr(0, slash);
+        }
+    }
+
+    void hashFiles(void) {
+        std::vector<Blob::BlobFile> dirtyFiles;
+        for (const WalkDirectory& directory : walked) {
+            // Names of the files the base tree has in this directory, read on first need
+            std::unordered_set<std::string> baseFiles;
+            bool baseFilesRead = false;
+
+            for (const WalkEntry& entry : directory.entries) {
+                const char* mode = fileMode(entry.st);
+                if (mode == nullptr)
+                    continue;
+
+                std::string path = joinPath(directory.path, entry.name);
+                auto cached = index.entries.find(path);
+                if (cached != index.entries.end()
+                    && index.statMatches(cached->second, entry.st, std::stoul(mode, nullptr, 8))) {
+                    fileHashes[path] = GitObjectUtility::toHex(
+                        reinterpret_cast<const uint8_t*>(cached->second.rawSHA.data()), 20);
+                    continue;
+                }
+
+                if (!baseFilesRead) {
+                    const std::string& baseHash = baseDirectoryHash(directory.path);
+                    if (!baseHash.empty()) {
+                        for (const Tree::TreeEntry& baseEntry : baseTreeEntries(baseHash)) {
+                            if (baseEntry.mode != "40000")
+                                baseFiles.insert(baseEntry.name);
+                        }
+                    }
+                    baseFilesRead = true;
+                }
+
+                // A file the base tree doesn't have is added whatever its content
+                if (baseFiles.count(entry.name))
+                    dirtyFiles.push_back({path, S_ISLNK(entry.st.st_mode) != 0});
+                else
+                    markDirty(directory.path);
+            }
+        }
+
+        // Hash on demand: only changed files that exist in the base are read
+        std::vector<std::string> dirtyHashes = Blob::hashBlobFiles(dirtyFiles, false);
+        for (size_t i = 0; i < dirtyFiles.size(); i++)
+            fileHashes[dirtyFiles[i].path] = std::move(dirtyHashes[i]);
+    }
+
+    // Tree hash of a worktree directory, computed bottom-up like write-tree.
+    // A dirty directory keeps its entries but gets no hash, since its new
+    // files were never hashed.
+    void hashDirectory(const std::string& path) {
+        std::vector<Tree::TreeEntry> entries;
+        auto directory = directoriesByPath.find(path);
+        if (directory != directoriesByPath.end()) {
+            for (const WalkEntry& entry : directory->second->entries) {
+                std::string childPath = joinPath(path, entry.name);
+                if (S_ISDIR(entry.st.st_mode)) {
+                    hashDirectory(childPath);
+                    if (!directoryEntries[childPath].empty())
+                        entries.push_back({"40000", entry.name, directoryHashes[childPath]});
+                } else if (const char* mode = fileMode(entry.st)) {
+                    entries.push_back({mode, entry.name, fileHashes[childPath]});
+                }
+            }
+        }
+
+        std::string hashString;
+        if (!entries.empty() && !dirtyDirectories.count(path)) {
+            SHA1 hash;
+            hash.update(Tree::treeObjectContent(entries));
+            hashString = hash.final();
+        }
+
+        directoryHashes[path] = hashString;
+        directoryEntries[path] = std::move(entries);
+    }
+
+    static std::vector<Tree::TreeEntry> readTreeEntries(const std::string& treeHash) {
+        GitObjectUtility gitObjectUtility(treeHash);
+        std::string treeString = gitObjectUtility.objectFileToString();
+
+        std::vector<TreeEntryRecord> records;
+        visitObjectKind(gitObjectUtility.header.kind, [&](auto kind) {
+            if constexpr (decltype(kind)::value == ObjectKind::Tree)
+                scanTreeEntries(treeString, gitObjectUtility.header.bodyOffset, records);
+            else
+                throw std::runtime_error("fatal: Not a tree object");
+        });
+
+        std::vector<Tree::TreeEntry> entries;
+        for (const TreeEntryRecord& record : records) {
+            std::ostringstream mode;
+            mode << std::oct << record.mode;
+            entries.push_back({mode.str(),
+                               treeString.substr(record.nameOffset, record.nameLength),
+                               GitObjectUtility::toHex(
+                                   reinterpret_cast<const uint8_t*>(treeString.data() + record.idOffset),
+                                   TREE_ENTRY_ID_BYTES)});
+        }
+        return entries;
+    }
+
+    void diff(const std::string& path, const std::string& baseHash, bool inWorktree) {
+        const std::string worktreeHash = inWorktree ? directoryHashes[path] : "";
+        bool dirty = inWorktree && dirtyDirectories.count(path);
+        // Identical subtrees are pruned before their base tree object is read
+        if (!dirty && baseHash == worktreeHash)
+            return;
+
+        static const std::vector<Tree::TreeEntry> noEntries;
+        const std::vector<Tree::TreeEntry>& baseEntries = baseHash.empty() ? noEntries : baseTreeEntries(baseHash);
+
+        std::map<std::string, std::pair<const Tree::TreeEntry*, const Tree::TreeEntry*>> merged;
+        for (const Tree::TreeEntry& entry : baseEntries)
+            merged[entry.name].first = &entry;
+        if (inWorktree) {
+            for (const Tree::TreeEntry& entry : directoryEntries[path])
+                merged[entry.name].second = &entry;
+        }
 
+        for (const auto& [name, pair] : merged) {
+            const Tree::TreeEntry* base = pair.first;
+            const Tree::TreeEntry* worktree = pair.second;
+            std::string childPath = joinPath(path, name);
+            bool baseIsTree = base != nullptr && base->mode == "40000";
+            bool worktreeIsTree = worktree != nullptr && worktree->mode == "40000";
+
+            if (base != nullptr && !baseIsTree && (worktree == nullptr || worktreeIsTree))
+                changes.push_back("D\t" + childPath);
+            if (worktree != nullptr && !worktreeIsTree && (base == nullptr || baseIsTree))
+                changes.push_back("A\t" + childPath);
+            if (base != nullptr && worktree != nullptr && !baseIsTree && !worktreeIsTree
+                && (base->hashString != worktree->hashString || base->mode != worktree->mode))
+                changes.push_back("M\t" + childPath);
+
+            if (baseIsTree || worktreeIsTree)
+                diff(childPath, baseIsTree ? base->hashString : "", worktreeIsTree);
+        }
+    }
+
+public:
+    // Changed paths relative to the tree, as "<A|D|M>\t<path>" lines.
+    // An empty base hash compares against the empty tree.
+    std::vector<std::string> compare(const std::string& baseTreeHash) {
+        this->baseTreeHash = baseTreeHash;
+        index.read(".git/index");
+
+        walked = walkWorktree(".", ".git");
+        for (const WalkDirectory& directory : walked)
+            directoriesByPath[directory.path] = &directory;
+
+        hashFiles();
+        hashDirectory("");
+        diff("", baseTreeHash, true);
+        return changes;
+    }
 };
 
 
@@ -230,6 +894,41 @@ private:
     std::string command;
     std::string flag;
 
+    // Print the entries of an inflated tree object starting at the content offset
+    void printTreeEntries(const std::string& treeString, size_t pos,
+                          GitObjectUtility& gitObjectUtility, bool nameOnly) {
+        // Tokenise the whole tree in one sweep
+        std::vector<TreeEntryRecord> entries;
+        scanTreeEntries(treeString, pos, entries);
+
+        for (const TreeEntryRecord& entry : entries) {
+            std::string_view name(treeString.data() + entry.nameOffset, entry.nameLength);
+            if (nameOnly) {
+                std::cout << name << '\n';
+                continue;
+            }
+
+            const char* modeNumber;
+            const char* mode;
+            switch (entry.mode) {
+                case 040000:  modeNumber = "040000"; mode = "tree";   break;
+                case 0100644: modeNumber = "100644"; mode = "blob";   break;
+                case 0100755: modeNumber = "100755"; mode = "blob";   break;
+                case 0120000: modeNumber = "120000"; mode = "blob";   break;
+                case 0160000: modeNumber = "160000"; mode = "commit"; break;
+                default:
+                    throw std::runtime_error("Invalid object mode number in tree object file");
+            }
+
+            const uint8_t* hexBuffer = reinterpret_cast<const uint8_t*>(treeString.data() + entry.idOffset);
+            std::string hexString = gitObjectUtility.toHex(hexBuffer, TREE_ENTRY_ID_BYTES);
+
+            // Output object info in a line
+            std::cout << modeNumber << ' ' << mode << ' ' << hexString << "    " << name << '\n';
+        }
+        std::cout.flush();
+    }
+
 public:
     GitCommand(std::string command, const int argc)
         : command(command), argc(argc) {}
@@ -276,24 +975,23 @@ public:
 
         // Create the object utility structure
         GitObjectUtility gitObjectUtility(objectSHA);
-        // Read the object file to a string
-        std::string catString;
-        try {
-            catString = gitObjectUtility.objectFileToString();
-        } catch (std::runtime_error& e) {
-            throw;
-        } catch (std::exception& e) {
-            throw;
-        }
-
-        // Find the NULL character
-        size_t nullPos = catString.find('\0');
-        if (nullPos == std::string::npos)
-            throw std::runtime_error("Invalid git object format: no null character found");
 
-        // Separating header from the rest
-        catString.erase(0, nullPos + 1);
-        std::cout << catString;
+        // Stream the content to stdout as it is inflated. Trees are collected
+        // instead, since they are pretty-printed entry by entry.
+        std::string treeString;
+        std::function<void()> finish = []() {};
+        gitObjectUtility.inflateObjectChunks([&](const ObjectHeader& header) {
+            return visitObjectKind(header.kind, [&](auto kind) -> GitObjectUtility::ContentSink {
+                if constexpr (decltype(kind)::value == ObjectKind::Tree) {
+                    treeString.reserve(header.size);
+                    finish = [&]() { printTreeEntries(treeString, 0, gitObjectUtility, false); };
+                    return [&](const char* data, size_t size) { treeString.append(data, size); };
+                } else {
+                    return [](const char* data, size_t size) { writeBufferToFd(STDOUT_FILENO, data, size); };
+                }
+            });
+        });
+        finish();
     }
 
     void lsTree(char* argv[]) {
@@ -329,94 +1027,118 @@ public:
             throw;
         }
 
-        if (gitObjectUtility.objectType != "tree")
-            throw std::runtime_error("fatal: Not a tree object");
-
-        // Find the NULL character
-        size_t nullPos = lsTreeString.find('\0');
-        if (nullPos == std::string::npos)
-            throw std::runtime_error("Invalid git tree format: no null character found");
-
-        // Separating content from the header
-        lsTreeString.erase(0, nullPos + 1);
-
-        // Keep parsing the content of tree file and shortening it
-        while (lsTreeString.size() > 0) {
-            // Parsing file mode
-            size_t firstSpace = lsTreeString.find(' ');
-            std::string modeNumber = lsTreeString.substr(0, firstSpace);
-            std::string mode;
-
-            if (modeNumber != "40000" && modeNumber != "100755" && modeNumber != "100644") {
-                throw std::runtime_error("Invalid object mode number in tree object file");
-            } else if (modeNumber == "40000") {
-                modeNumber = "040000";
-                mode = "tree";
-            } else {
-                mode = "blob";
-            }
-            // Dynamically shortening the string
-            lsTreeString.erase(0, firstSpace + 1);
-
-            // Parsing file/folder name
-            nullPos = lsTreeString.find('\0');
-            std::string name = lsTreeString.substr(0, nullPos);
-            // Done with upto file name
-            lsTreeString.erase(0, nullPos + 1);
-
-            // Now parsing raw 20 byte SHA1 hash of the object
-            size_t hexBufferSize = 20;
-            uint8_t hexBuffer[hexBufferSize];
-            if (lsTreeString.size() < hexBufferSize)
-                throw std::runtime_error("Invalid tree object file format");
-
-            std::copy(lsTreeString.begin(), lsTreeString.begin() + hexBufferSize, hexBuffer);
-            std::string hexString = gitObjectUtility.toHex(hexBuffer, hexBufferSize);
-
-            // Dealt with one object, onto the next in next iteration
-            lsTreeString.erase(0, hexBufferSize);
-
-            // Output object info in a line
-            if (flag == "--name-only")
-                std::cout << name << std::endl;
+        visitObjectKind(gitObjectUtility.header.kind, [&](auto kind) {
+            if constexpr (decltype(kind)::value == ObjectKind::Tree)
+                printTreeEntries(lsTreeString, gitObjectUtility.header.bodyOffset, gitObjectUtility,
+                                 flag == "--name-only");
             else
-                std::cout << modeNumber + " " + mode + " " + hexString + "    " + name << std::endl;
-        }
+                throw std::runtime_error("fatal: Not a tree object");
+        });
     }
 
     void hashObject(char* argv[]) {
         if (argc <= 3)
-            throw std::runtime_error("Usage: path/to/your_git hash-object -w <file-name>");
+            throw std::runtime_error("Usage: path/to/your_git hash-object -w <file-name>...");
 
         flag = argv[2];
         if (flag != "-w")
             throw std::runtime_error("Invalid hash-object flag: expected `-w`");
 
-        // Read the file name
-        std::string fileName = argv[3];
+        // Blob objects for every file, hashed and written as one batch
+        std::vector<Blob::BlobFile> files;
+        for (int i = 3; i < argc; i++)
+            files.push_back({argv[i], false});
 
-        // Create the blob object
-        Blob blobObject(fileName);
-        try {
-            blobObject.createBlobObject();
-        } catch (std::filesystem::filesystem_error& e) {
-            throw;
-        } catch (std::runtime_error& e) {
-            throw;
-        } catch (std::exception& e) {
-            throw;
+        std::vector<std::string> hashStrings = Blob::hashBlobFiles(files, true);
+        for (const std::string& hashString : hashStrings)
+            std::cout << hashString << '\n';
+    }
+
+    // Tree hash for a tree or commit hash, or for HEAD when objectSHA is empty.
+    // Returns an empty string while HEAD has no commits.
+    std::string resolveTree(std::string objectSHA) {
+        if (objectSHA.empty()) {
+            std::string head = readFileToString(".git/HEAD");
+            head.erase(head.find_last_not_of("\r\n") + 1);
+            if (head.rfind("ref: ", 0) == 0) {
+                std::string refName = head.substr(5);
+                std::string refPath = ".git/" + refName;
+                if (std::filesystem::exists(refPath)) {
+                    objectSHA = readFileToString(refPath).substr(0, 40);
+                } else if (std::filesystem::exists(".git/packed-refs")) {
+                    // "<SHA1 hash> <ref name>" lines
+                    std::istringstream packedRefs(readFileToString(".git/packed-refs"));
+                    std::string line;
+                    while (std::getline(packedRefs, line)) {
+                        if (line.size() == 41 + refName.size() && line.compare(41, refName.size(), refName) == 0)
+                            objectSHA = line.substr(0, 40);
+                    }
+                }
+                if (objectSHA.empty())
+                    return "";
+            } else {
+                objectSHA = head.substr(0, 40);
+            }
         }
+
+        if (objectSHA.length() != 40)
+            throw std::runtime_error("fatal: Not a valid object name");
+
+        GitObjectUtility gitObjectUtility(objectSHA);
+        std::string objectString = gitObjectUtility.objectFileToString();
+        size_t bodyOffset = gitObjectUtility.header.bodyOffset;
+        return visitObjectKind(gitObjectUtility.header.kind, [&](auto kind) -> std::string {
+            constexpr ObjectKind K = decltype(kind)::value;
+            if constexpr (K == ObjectKind::Tree) {
+                return objectSHA;
+            } else if constexpr (K == ObjectKind::Commit) {
+                // A commit starts with "tree <SHA1 hash>"
+                if (objectString.compare(bodyOffset, 5, "tree ") != 0)
+                    throw std::runtime_error("fatal: Invalid commit object " + objectSHA);
+                return objectString.substr(bodyOffset + 5, 40);
+            } else {
+                throw std::runtime_error("fatal: Not a tree object");
+            }
+        });
     }
 
-    bool writeTree(char* argv[]) {
+    void status(char* argv[]) {
+        if (argc > 3)
+            throw std::runtime_error("Usage: path/to/your_git.sh status <tree or commit SHA1 hash>(optional)");
 
-        return true;
+        std::string treeSHA = resolveTree(argc == 3 ? argv[2] : "");
+
+        WorktreeStatus worktreeStatus;
+        for (const std::string& change : worktreeStatus.compare(treeSHA))
+            std::cout << change << '\n';
+    }
+
+    void writeTree(char* argv[]) {
+        if (argc != 2)
+            throw std::runtime_error("Usage: path/to/your_git.sh write-tree");
+
+        Tree tree(".");
+        std::string hashString = tree.createTreeObject();
+        if (hashString.empty()) {
+            // An empty working directory still has a (well-known) empty tree
+            std::string treeContent = objectHeader<ObjectKind::Tree>(0);
+            SHA1 hash;
+            hash.update(treeContent);
+            hashString = hash.final();
+            GitObjectUtility(hashString).writeObject(treeContent);
+        }
+
+        std::cout << hashString << '\n';
     }
 };
 
 
 int main(int argc, char *argv[])
 {
+    // Fast start: commands print through std::cout (or raw write(2)) only, so
+    // the streams don't need to stay in sync with C stdio
+    std::ios::sync_with_stdio(false);
+
     if (argc < 2) {
         std::cerr << "No command provided.\n";
         return EXIT_FAILURE;
@@ -472,6 +1194,34 @@ int main(int argc, char *argv[])
             return EXIT_FAILURE;
         }
 
+    } else if (cmd == "write-tree") {
+        try {
+            gitCommand.writeTree(argv);
+        } catch (std::filesystem::filesystem_error& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        } catch (std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        } catch (std::exception& e) {
+            std::cerr << "Unexpected error: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+    } else if (cmd == "status") {
+        try {
+            gitCommand.status(argv);
+        } catch (std::filesystem::filesystem_error& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        } catch (std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        } catch (std::exception& e) {
+            std::cerr << "Unexpected error: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+
     } else {
         std::cerr << "Unknown command " << cmd << '\n';
         return EXIT_FAILURE;
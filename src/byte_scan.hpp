@@ -0,0 +1,85 @@
+/*
+    byte_scan.hpp - single-sweep tokenising of object headers and trees
+
+    A ByteScanner finds the next position holding a given byte with memchr,
+    which the C library already vectorises. Tree entries are tokenised in one
+    forward sweep, with the octal mode parsed in place, instead of copying
+    every token out with std::string::find and substr.
+*/
+
+#ifndef BYTE_SCAN_HPP
+#define BYTE_SCAN_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+
+class ByteScanner {
+public:
+    ByteScanner(std::string_view data, char needle)
+        : data(data), needle(needle) {}
+
+    // Index of the first needle at or after pos, or data.size() if none
+    size_t next(size_t pos) const {
+        if (pos >= data.size())
+            return data.size();
+        const void* hit = std::memchr(data.data() + pos, needle, data.size() - pos);
+        return hit ? static_cast<size_t>(static_cast<const char*>(hit) - data.data()) : data.size();
+    }
+
+private:
+    std::string_view data;
+    char needle;
+};
+
+
+// One parsed tree entry, as offsets into the inflated tree object
+struct TreeEntryRecord {
+    uint32_t mode;          // Numeric value of the octal mode, e.g. 040000
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t idOffset;      // Start of the raw 20 byte object id
+};
+
+inline constexpr size_t TREE_ENTRY_ID_BYTES = 20;
+
+// Tokenise the entries of tree content starting at pos in a single sweep.
+// Entries are "<octal mode> <name>\0<20 byte id>".
+inline void scanTreeEntries(std::string_view tree, size_t pos, std::vector<TreeEntryRecord>& entries) {
+    if (tree.size() > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("Tree object too large");
+
+    ByteScanner nullScanner(tree, '\0');
+    while (pos < tree.size()) {
+        // The mode is at most a handful of octal digits; parse it in place
+        uint32_t mode = 0;
+        size_t modeStart = pos;
+        while (pos < tree.size() && tree[pos] >= '0' && tree[pos] <= '7') {
+            mode = (mode << 3) | static_cast<uint32_t>(tree[pos] - '0');
+            pos++;
+        }
+        if (pos == modeStart || pos - modeStart > 6 || pos >= tree.size() || tree[pos] != ' ')
+            throw std::runtime_error("Invalid object mode number in tree object file");
+
+        size_t nameStart = pos + 1;
+        size_t nullPos = nullScanner.next(nameStart);
+        if (nullPos == tree.size() || tree.size() - (nullPos + 1) < TREE_ENTRY_ID_BYTES)
+            throw std::runtime_error("Invalid tree object file format");
+
+        entries.push_back({mode,
+                           static_cast<uint32_t>(nameStart),
+                           static_cast<uint32_t>(nullPos - nameStart),
+                           static_cast<uint32_t>(nullPos + 1)});
+
+        pos = nullPos + 1 + TREE_ENTRY_ID_BYTES;
+    }
+}
+
+
+#endif /* BYTE_SCAN_HPP */
@@ -0,0 +1,131 @@
+/*
+    git_index.hpp - read-only access to the .git/index stat cache
+
+    Parses version 2 and 3 index files as written by git. Only the per-path
+    stat data, mode and object id are kept; extensions are ignored. The
+    status command uses the entries to skip hashing files whose lstat data
+    is unchanged since they were last staged.
+*/
+
+#ifndef GIT_INDEX_HPP
+#define GIT_INDEX_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+
+struct IndexEntry {
+    uint32_t ctimeSeconds;
+    uint32_t ctimeNanoseconds;
+    uint32_t mtimeSeconds;
+    uint32_t mtimeNanoseconds;
+    uint32_t ino;
+    uint32_t mode;
+    uint32_t size;
+    std::string rawSHA;     // 20 raw bytes
+    bool conflicted;        // Stage other than 0
+};
+
+class GitIndex {
+public:
+    std::unordered_map<std::string, IndexEntry> entries;
+    struct stat indexStat{};
+    bool loaded = false;
+
+    // Read the index at path. A missing index leaves the cache empty.
+    void read(const std::string& path) {
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (!file.is_open())
+            return;
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        stat(path.c_str(), &indexStat);
+
+        if (data.size() < 12 + 20 || data.compare(0, 4, "DIRC") != 0)
+            throw std::runtime_error("fatal: index file corrupt");
+
+        uint32_t version = be32(data, 4);
+        uint32_t count = be32(data, 8);
+        if (version != 2 && version != 3)
+            return;  // Version 4 prefix-compresses paths; treat as no cache
+
+        size_t pos = 12;
+        for (uint32_t i = 0; i < count; i++) {
+            const size_t fixedBytes = 62;
+            if (pos + fixedBytes > data.size())
+                throw std::runtime_error("fatal: index file corrupt");
+
+            IndexEntry entry;
+            entry.ctimeSeconds = be32(data, pos);
+            entry.ctimeNanoseconds = be32(data, pos + 4);
+            entry.mtimeSeconds = be32(data, pos + 8);
+            entry.mtimeNanoseconds = be32(data, pos + 12);
+            entry.ino = be32(data, pos + 20);
+            entry.mode = be32(data, pos + 24);
+            entry.size = be32(data, pos + 36);
+            entry.rawSHA = data.substr(pos + 40, 20);
+
+            uint16_t flags = be16(data, pos + 60);
+            entry.conflicted = ((flags >> 12) & 0x3) != 0;
+
+            size_t nameStart = pos + fixedBytes;
+            if (flags & 0x4000) {
+                // Extended flags, version 3 only
+                nameStart += 2;
+            }
+
+            size_t nameEnd = data.find('\0', nameStart);
+            if (nameEnd == std::string::npos)
+                throw std::runtime_error("fatal: index file corrupt");
+            std::string name = data.substr(nameStart, nameEnd - nameStart);
+
+            // Entries are padded with 1-8 null bytes to a multiple of eight
+            size_t entryLength = nameEnd - pos;
+            pos += (entryLength + 8) & ~static_cast<size_t>(7);
+
+            auto inserted = entries.emplace(std::move(name), entry);
+            if (!inserted.second && entry.conflicted)
+                inserted.first->second.conflicted = true;
+        }
+        loaded = true;
+    }
+
+    // True if the lstat data still matches the entry and the entry can't be
+    // "racily clean" (modified in the same second the index was written).
+    bool statMatches(const IndexEntry& entry, const struct stat& st, uint32_t mode) const {
+        if (entry.conflicted || entry.mode != mode)
+            return false;
+        if (entry.mtimeSeconds != static_cast<uint32_t>(st.st_mtim.tv_sec)
+            || entry.mtimeNanoseconds != static_cast<uint32_t>(st.st_mtim.tv_nsec)
+            || entry.ctimeSeconds != static_cast<uint32_t>(st.st_ctim.tv_sec)
+            || entry.ctimeNanoseconds != static_cast<uint32_t>(st.st_ctim.tv_nsec)
+            || entry.ino != static_cast<uint32_t>(st.st_ino)
+            || entry.size != static_cast<uint32_t>(st.st_size))
+            return false;
+
+        return st.st_mtim.tv_sec < indexStat.st_mtim.tv_sec
+            || (st.st_mtim.tv_sec == indexStat.st_mtim.tv_sec
+                && st.st_mtim.tv_nsec < indexStat.st_mtim.tv_nsec);
+    }
+
+private:
+    static uint32_t be32(const std::string& data, size_t pos) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data() + pos);
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+    }
+
+    static uint16_t be16(const std::string& data, size_t pos) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data() + pos);
+        return static_cast<uint16_t>(p[0] << 8 | p[1]);
+    }
+};
+
+
+#endif /* GIT_INDEX_HPP */
@@ -0,0 +1,144 @@
+/*
+    object_kind.hpp - compile-time description of git object kinds
+
+    Every loose object starts with "<type> <size>\0". ObjectTraits maps each
+    kind to its type name at compile time. Headers are formatted from the
+    traits of a statically known kind, and parsed by matching the names of all
+    kinds in one compile-time unrolled compare. Commands switch on the parsed
+    kind once through visitObjectKind and handle each kind with if constexpr.
+*/
+
+#ifndef OBJECT_KIND_HPP
+#define OBJECT_KIND_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "byte_scan.hpp"
+
+
+enum class ObjectKind : uint8_t { Blob, Tree, Commit, Tag };
+
+inline constexpr size_t OBJECT_KIND_COUNT = 4;
+
+
+template <ObjectKind K>
+struct ObjectTraits;
+
+template <>
+struct ObjectTraits<ObjectKind::Blob> {
+    static constexpr std::string_view name = "blob";
+};
+
+template <>
+struct ObjectTraits<ObjectKind::Tree> {
+    static constexpr std::string_view name = "tree";
+};
+
+template <>
+struct ObjectTraits<ObjectKind::Commit> {
+    static constexpr std::string_view name = "commit";
+};
+
+template <>
+struct ObjectTraits<ObjectKind::Tag> {
+    static constexpr std::string_view name = "tag";
+};
+
+// Type tag handed to visitors, so the kind is a template argument in their body
+template <ObjectKind K>
+using ObjectKindTag = std::integral_constant<ObjectKind, K>;
+
+
+// Call f(ObjectKindTag<K>{}) for the runtime kind. This is the single dispatch
+// point; everything past it is resolved at compile time.
+template <class F>
+decltype(auto) visitObjectKind(ObjectKind kind, F&& f) {
+    switch (kind) {
+        case ObjectKind::Blob:   return std::forward<F>(f)(ObjectKindTag<ObjectKind::Blob>{});
+        case ObjectKind::Tree:   return std::forward<F>(f)(ObjectKindTag<ObjectKind::Tree>{});
+        case ObjectKind::Commit: return std::forward<F>(f)(ObjectKindTag<ObjectKind::Commit>{});
+        case ObjectKind::Tag:    return std::forward<F>(f)(ObjectKindTag<ObjectKind::Tag>{});
+    }
+    throw std::runtime_error("fatal error: Invalid object type");
+}
+
+
+// "<type> <size>\0" for an object of kind K
+template <ObjectKind K>
+std::string objectHeader(size_t contentSize) {
+    constexpr std::string_view name = ObjectTraits<K>::name;
+    std::string header;
+    header.reserve(name.size() + 22);
+    header.append(name);
+    header += ' ';
+    header += std::to_string(contentSize);
+    header += '\0';
+    return header;
+}
+
+
+struct ObjectHeader {
+    ObjectKind kind;
+    size_t size;        // Content size declared in the header
+    size_t bodyOffset;  // Index of the first content byte, one past the '\0'
+};
+
+namespace detail {
+
+// Matches "<name> " at the start of data for kind K
+template <ObjectKind K>
+constexpr bool matchesKindPrefix(std::string_view data) {
+    constexpr std::string_view name = ObjectTraits<K>::name;
+    return data.size() > name.size()
+        && data[name.size()] == ' '
+        && std::memcmp(data.data(), name.data(), name.size()) == 0;
+}
+
+template <size_t... I>
+bool matchKind(std::string_view data, ObjectKind& kind, size_t& nameLength, std::index_sequence<I...>) {
+    // Unrolled at compile time: one fixed-length compare per kind
+    return ((matchesKindPrefix<static_cast<ObjectKind>(I)>(data)
+                ? (kind = static_cast<ObjectKind>(I),
+                   nameLength = ObjectTraits<static_cast<ObjectKind>(I)>::name.size(),
+                   true)
+                : false) || ...);
+}
+
+} // namespace detail
+
+// Parse the header at the start of data. Only the header bytes are examined,
+// so data may be a prefix of the inflated object.
+inline ObjectHeader parseObjectHeader(std::string_view data) {
+    ObjectHeader header{};
+    size_t nameLength = 0;
+    if (!detail::matchKind(data, header.kind, nameLength, std::make_index_sequence<OBJECT_KIND_COUNT>{}))
+        throw std::runtime_error("fatal error: Invalid object type");
+
+    // Locate the terminating null with the block scanner, then read the size
+    size_t digitsStart = nameLength + 1;
+    size_t nullPos = ByteScanner(data, '\0').next(digitsStart);
+    if (nullPos == digitsStart || nullPos == data.size() || nullPos - digitsStart > 20)
+        throw std::runtime_error("Invalid git object format: malformed header");
+
+    size_t size = 0;
+    for (size_t pos = digitsStart; pos < nullPos; pos++) {
+        if (data[pos] < '0' || data[pos] > '9')
+            throw std::runtime_error("Invalid git object format: malformed header");
+        size = size * 10 + static_cast<size_t>(data[pos] - '0');
+    }
+
+    header.size = size;
+    header.bodyOffset = nullPos + 1;
+    return header;
+}
+
+
+#endif /* OBJECT_KIND_HPP */
@@ -0,0 +1,197 @@
+/*
+    sha1_multi.hpp - multi-buffer SHA-1 for many small messages
+
+    Hashes several independent messages at once, one message per 32 bit
+    lane of a vector register: 16 lanes with AVX-512, 8 with AVX2 and 4 with
+    SSE2 or NEON. The lane arithmetic uses GCC/Clang vector extensions, so the
+    instruction set follows the -m/-march flags of the build.
+
+    Without a vector unit, for messages larger than SHA1_MULTI_MAX_BYTES and
+    for batches too small to fill two lanes, the serial SHA1 class from
+    sha1.hpp is used instead.
+*/
+
+#ifndef SHA1_MULTI_HPP
+#define SHA1_MULTI_HPP
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sha1.hpp"
+
+
+#if defined(__AVX512F__)
+inline constexpr size_t SHA1_MULTI_LANES = 16;
+#elif defined(__AVX2__)
+inline constexpr size_t SHA1_MULTI_LANES = 8;
+#elif defined(__SSE2__) || defined(__ARM_NEON)
+inline constexpr size_t SHA1_MULTI_LANES = 4;
+#else
+inline constexpr size_t SHA1_MULTI_LANES = 1;
+#endif
+
+// Above this size a message has enough blocks for the serial path to be as fast
+inline constexpr size_t SHA1_MULTI_MAX_BYTES = 16 * 1024;
+
+typedef uint32_t sha1_lanes_t __attribute__((vector_size(SHA1_MULTI_LANES * sizeof(uint32_t))));
+
+
+namespace detail {
+
+inline std::string sha1Serial(std::string_view message) {
+    SHA1 hash;
+    hash.update(std::string(message));
+    return hash.final();
+}
+
+inline sha1_lanes_t rolLanes(sha1_lanes_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+inline uint32_t loadBigEndian32(const unsigned char* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+// Number of 64 byte blocks in the padded message
+inline size_t sha1BlockCount(size_t length) {
+    return (length + 8) / BLOCK_BYTES + 1;
+}
+
+// Copy block `index` of the padded message into out
+inline void sha1PaddedBlock(std::string_view message, size_t index, unsigned char out[BLOCK_BYTES]) {
+    size_t start = index * BLOCK_BYTES;
+    size_t available = start < message.size() ? std::min(BLOCK_BYTES, message.size() - start) : 0;
+    std::memcpy(out, message.data() + start, available);
+    std::memset(out + available, 0, BLOCK_BYTES - available);
+
+    if (start <= message.size() && message.size() < start + BLOCK_BYTES)
+        out[message.size() - start] = 0x80;
+
+    if (index + 1 == sha1BlockCount(message.size())) {
+        uint64_t totalBits = static_cast<uint64_t>(message.size()) * 8;
+        for (size_t i = 0; i < 8; i++)
+            out[BLOCK_BYTES - 1 - i] = static_cast<unsigned char>(totalBits >> (8 * i));
+    }
+}
+
+// Hash up to SHA1_MULTI_LANES messages, one per lane; hex digests go to out
+inline void sha1Lanes(const std::string_view* messages, size_t count, std::string* out) {
+    size_t blockCount[SHA1_MULTI_LANES] = {};
+    size_t maxBlocks = 0;
+    for (size_t lane = 0; lane < count; lane++) {
+        blockCount[lane] = sha1BlockCount(messages[lane].size());
+        maxBlocks = std::max(maxBlocks, blockCount[lane]);
+    }
+
+    sha1_lanes_t digest[5];
+    const uint32_t init[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+    for (size_t i = 0; i < 5; i++)
+        for (size_t lane = 0; lane < SHA1_MULTI_LANES; lane++)
+            digest[i][lane] = init[i];
+
+    unsigned char padded[BLOCK_BYTES];
+    for (size_t b = 0; b < maxBlocks; b++) {
+        // Transpose block b of every lane into the schedule; finished lanes are masked
+        sha1_lanes_t w[BLOCK_INTS] = {};
+        sha1_lanes_t active = {};
+        for (size_t lane = 0; lane < count; lane++) {
+            if (b >= blockCount[lane])
+                continue;
+            active[lane] = 0xffffffff;
+
+            const unsigned char* block;
+            if ((b + 1) * BLOCK_BYTES <= messages[lane].size()) {
+                block = reinterpret_cast<const unsigned char*>(messages[lane].data()) + b * BLOCK_BYTES;
+            } else {
+                sha1PaddedBlock(messages[lane], b, padded);
+                block = padded;
+            }
+            for (size_t i = 0; i < BLOCK_INTS; i++)
+                w[i][lane] = loadBigEndian32(block + 4 * i);
+        }
+
+        sha1_lanes_t a = digest[0], bb = digest[1], c = digest[2], d = digest[3], e = digest[4];
+        for (size_t t = 0; t < 80; t++) {
+            if (t >= 16)
+                w[t & 15] = rolLanes(w[(t + 13) & 15] ^ w[(t + 8) & 15] ^ w[(t + 2) & 15] ^ w[t & 15], 1);
+
+            sha1_lanes_t f;
+            uint32_t k;
+            if (t < 20)      { f = ((c ^ d) & bb) ^ d;         k = 0x5a827999; }
+            else if (t < 40) { f = bb ^ c ^ d;                 k = 0x6ed9eba1; }
+            else if (t < 60) { f = (bb & c) | ((bb | c) & d);  k = 0x8f1bbcdc; }
+            else             { f = bb ^ c ^ d;                 k = 0xca62c1d6; }
+
+            sha1_lanes_t temp = rolLanes(a, 5) + f + e + k + w[t & 15];
+            e = d;
+            d = c;
+            c = rolLanes(bb, 30);
+            bb = a;
+            a = temp;
+        }
+
+        digest[0] += a & active;
+        digest[1] += bb & active;
+        digest[2] += c & active;
+        digest[3] += d & active;
+        digest[4] += e & active;
+    }
+
+    static const char hexDigits[] = "0123456789abcdef";
+    for (size_t lane = 0; lane < count; lane++) {
+        std::string& hex = out[lane];
+        hex.resize(40);
+        for (size_t i = 0; i < 5; i++) {
+            uint32_t word = digest[i][lane];
+            for (size_t j = 0; j < 8; j++)
+                hex[8 * i + j] = hexDigits[(word >> (28 - 4 * j)) & 0xf];
+        }
+    }
+}
+
+} // namespace detail
+
+
+// Hex SHA-1 of every message, in input order
+inline std::vector<std::string> sha1Many(const std::vector<std::string_view>& messages) {
+    std::vector<std::string> digests(messages.size());
+
+    // Small messages are grouped by length so the lanes of a batch finish together
+    std::vector<size_t> order;
+    for (size_t i = 0; i < messages.size(); i++) {
+        if (messages[i].size() <= SHA1_MULTI_MAX_BYTES)
+            order.push_back(i);
+        else
+            digests[i] = detail::sha1Serial(messages[i]);
+    }
+    std::sort(order.begin(), order.end(), [&messages](size_t x, size_t y) {
+        return messages[x].size() < messages[y].size();
+    });
+
+    std::string_view batch[SHA1_MULTI_LANES];
+    std::string batchDigests[SHA1_MULTI_LANES];
+    for (size_t start = 0; start < order.size(); start += SHA1_MULTI_LANES) {
+        size_t count = std::min(SHA1_MULTI_LANES, order.size() - start);
+        if (count == 1) {
+            digests[order[start]] = detail::sha1Serial(messages[order[start]]);
+            continue;
+        }
+
+        for (size_t lane = 0; lane < count; lane++)
+            batch[lane] = messages[order[start + lane]];
+        detail::sha1Lanes(batch, count, batchDigests);
+        for (size_t lane = 0; lane < count; lane++)
+            digests[order[start + lane]] = std::move(batchDigests[lane]);
+    }
+
+    return digests;
+}
+
+
+#endif /* SHA1_MULTI_HPP */
@@ -0,0 +1,173 @@
+/*
+    worktree_walk.hpp - parallel directory walk with lstat data
+
+    Worker threads pull directories from a shared queue, read them and lstat
+    every entry relative to the open directory, then queue the
+    subdirectories they find. Directories are therefore listed in parallel
+    across the whole tree, not just across the children of one directory.
+*/
+
+#ifndef WORKTREE_WALK_HPP
+#define WORKTREE_WALK_HPP
+
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+
+struct WalkEntry {
+    std::string name;
+    struct stat st;
+};
+
+struct WalkDirectory {
+    std::string path;   // Relative to the walk root, "" for the root itself
+    std::vector<WalkEntry> entries;
+};
+
+
+// One thread per core, unless GIT_WORKER_THREADS asks for a given number
+inline size_t defaultWalkThreads(void) {
+    if (const char* override = std::getenv("GIT_WORKER_THREADS")) {
+        long threads = std::strtol(override, nullptr, 10);
+        if (threads > 0)
+            return static_cast<size_t>(threads);
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Run fn(i) for every i in [0, count) on up to `threads` threads
+template <class F>
+void parallelFor(size_t count, size_t threads, F fn) {
+    threads = std::min(threads, count);
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; i++)
+            fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            try {
+                for (size_t i = next++; i < count; i = next++)
+                    fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error)
+                    error = std::current_exception();
+                next = count;
+            }
+        });
+    }
+    for (std::thread& worker : workers)
+        worker.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// List every directory below root, skipping entries named `skipName` (".git").
+// The order of the returned directories is unspecified.
+inline std::vector<WalkDirectory> walkWorktree(const std::string& root, const std::string& skipName,
+                                               size_t threads = defaultWalkThreads()) {
+    std::vector<WalkDirectory> directories;
+    std::deque<std::string> pending{""};
+    size_t busy = 0;
+    bool failed = false;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+
+    auto listDirectory = [&](const std::string& relativePath) {
+        WalkDirectory directory{relativePath, {}};
+        std::vector<std::string> subdirectories;
+
+        std::string fullPath = relativePath.empty() ? root : root + "/" + relativePath;
+        DIR* dir = opendir(fullPath.c_str());
+        if (dir == nullptr)
+            throw std::runtime_error("fatal: Couldn't open directory " + fullPath);
+
+        int fd = dirfd(dir);
+        while (struct dirent* dirEntry = readdir(dir)) {
+            std::string name = dirEntry->d_name;
+            if (name == "." || name == ".." || name == skipName)
+                continue;
+
+            WalkEntry entry{name, {}};
+            if (fstatat(fd, name.c_str(), &entry.st, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;  // Removed since readdir
+
+            if (S_ISDIR(entry.st.st_mode))
+                subdirectories.push_back(relativePath.empty() ? name : relativePath + "/" + name);
+            directory.entries.push_back(std::move(entry));
+        }
+        closedir(dir);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        directories.push_back(std::move(directory));
+        for (std::string& subdirectory : subdirectories)
+            pending.push_back(std::move(subdirectory));
+    };
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wakeUp.wait(lock, [&]() { return failed || !pending.empty() || busy == 0; });
+            if (failed || pending.empty())
+                break;
+
+            std::string relativePath = std::move(pending.front());
+            pending.pop_front();
+            busy++;
+            lock.unlock();
+
+            try {
+                listDirectory(relativePath);
+            } catch (...) {
+                lock.lock();
+                if (!error)
+                    error = std::current_exception();
+                failed = true;
+                busy--;
+                wakeUp.notify_all();
+                break;
+            }
+
+            lock.lock();
+            busy--;
+            wakeUp.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& thread : workers)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+    return directories;
+}
+
+
+#endif /* WORKTREE_WALK_HPP */
@@ -0,0 +1,44 @@
+// Times scanTreeEntries against the find()-based reference parser on a
+// 200k entry tree, the size of a large flat directory.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "byte_scan.hpp"
+#include "test_util.hpp"
+
+
+int main(void) {
+    if (!cpuSupportsBuildTarget())
+        return TEST_SKIPPED;
+
+    const size_t entryCount = 200000;
+    const int rounds = 20;
+
+    std::string tree;
+    for (size_t i = 0; i < entryCount; i++) {
+        tree += "100644 src/module_" + std::to_string(i) + "/source_file.cpp";
+        tree += '\0';
+        tree += std::string(TREE_ENTRY_ID_BYTES, 'x');
+    }
+
+    size_t checksum = 0;
+    double scanSeconds = secondsFor([&]() {
+        for (int round = 0; round < rounds; round++) {
+            std::vector<TreeEntryRecord> entries;
+            entries.reserve(entryCount);
+            scanTreeEntries(tree, 0, entries);
+            checksum += entries.size();
+        }
+    });
+    double findSeconds = secondsFor([&]() {
+        for (int round = 0; round < rounds; round++)
+            checksum += findTreeEntries(tree).size();
+    });
+
+    std::printf("byte_scan_bench [%s]: %zu entries, scanTreeEntries %.2f ms, find() %.2f ms, %.2fx (%zu)\n",
+                buildTargetName(), entryCount, 1000 * scanSeconds / rounds, 1000 * findSeconds / rounds,
+                findSeconds / scanSeconds, checksum);
+    return 0;
+}
@@ -0,0 +1,76 @@
+// Checks scanTreeEntries and ByteScanner against find()-based references
+// on random trees.
+
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "byte_scan.hpp"
+#include "test_util.hpp"
+
+
+static bool sameRecords(const std::vector<TreeEntryRecord>& x, const std::vector<TreeEntryRecord>& y) {
+    if (x.size() != y.size())
+        return false;
+    for (size_t i = 0; i < x.size(); i++) {
+        if (x[i].mode != y[i].mode || x[i].nameOffset != y[i].nameOffset
+            || x[i].nameLength != y[i].nameLength || x[i].idOffset != y[i].idOffset)
+            return false;
+    }
+    return true;
+}
+
+int main(void) {
+    if (!cpuSupportsBuildTarget())
+        return TEST_SKIPPED;
+
+    std::mt19937 rng(27);
+    int failures = 0;
+
+    for (int round = 0; round < 5000; round++) {
+        std::string tree = randomTree(rng, 40);
+        std::vector<TreeEntryRecord> scanned;
+        try {
+            scanTreeEntries(tree, 0, scanned);
+        } catch (const std::runtime_error& e) {
+            std::printf("valid tree rejected in round %d: %s\n", round, e.what());
+            failures++;
+            continue;
+        }
+        if (!sameRecords(scanned, findTreeEntries(tree))) {
+            std::printf("tree mismatch in round %d (%zu bytes)\n", round, tree.size());
+            failures++;
+        }
+
+        // Forward queries from arbitrary positions must agree with find()
+        ByteScanner scanner(tree, ' ');
+        for (size_t pos = 0; pos <= tree.size(); pos += 1 + rng() % 40) {
+            size_t expected = tree.find(' ', pos);
+            if (expected == std::string::npos)
+                expected = tree.size();
+            if (scanner.next(pos) != expected) {
+                std::printf("scanner mismatch in round %d at %zu\n", round, pos);
+                failures++;
+                break;
+            }
+        }
+    }
+
+    // Truncated and malformed trees must be rejected, not read past the end
+    const std::string invalid[] = {"100644 name", std::string("100644 name\0short", 17),
+                                   "10x644 name", std::string("1234567 a\0", 10) + std::string(20, 'x')};
+    for (const std::string& tree : invalid) {
+        std::vector<TreeEntryRecord> scanned;
+        try {
+            scanTreeEntries(tree, 0, scanned);
+            std::printf("malformed tree accepted: %zu bytes\n", tree.size());
+            failures++;
+        } catch (const std::runtime_error&) {
+        }
+    }
+
+    std::printf("byte_scan_test [%s]: %s\n", buildTargetName(), failures == 0 ? "ok" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
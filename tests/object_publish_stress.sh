@@ -0,0 +1,136 @@
+#!/bin/sh
+#
+# object_publish_stress.sh - concurrent writers publishing the same objects
+#
+# Usage: object_publish_stress.sh <server binary> [-p <processes>] [-f <files>]
+#
+# Two cases, each run by several processes at once in one repository:
+#
+#   shared:    the files are split into one shard per process and every
+#              process runs `hash-object -w` on its own shard and the next
+#              one, so each object is written by two processes.
+#   repeated:  every process gets the same 1024 arguments, four rounds of
+#              128 files plus 128 copies with the same contents. That is
+#              four batches of HASH_BATCH_FILES, so the writer threads in a
+#              process race on the same ids in the in-process claim table.
+#
+# Each repository must then pass `git fsck --strict`, hold exactly one
+# object per distinct content and contain no leftover temporary files, and
+# every process must print the hashes git computes. The shared case is
+# also run one process after another; both throughputs are printed for
+# comparison but don't decide the result.
+#
+# Exits 77 (skipped) when git isn't installed.
+
+set -e
+
+processes=8
+files=2000
+server=""
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -p) processes="$2"; shift 2 ;;
+        -f) files="$2"; shift 2 ;;
+        *) server=$(realpath "$1"); shift ;;
+    esac
+done
+if [ -z "$server" ]; then
+    echo "Usage: $0 <server binary> [-p <processes>] [-f <files>]" >&2
+    exit 2
+fi
+if ! command -v git > /dev/null; then
+    echo "git not found, skipping"
+    exit 77
+fi
+
+# Run several writer threads per process even on a single core
+export GIT_WORKER_THREADS=4
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+mkdir "$work/files" "$work/repeated"
+i=0
+while [ $i -lt "$files" ]; do
+    echo "object $i" > "$work/files/f$i"
+    i=$((i + 1))
+done
+i=0
+while [ $i -lt 128 ]; do
+    echo "repeated $i" > "$work/repeated/d$i"
+    echo "repeated $i" > "$work/repeated/c$i"
+    i=$((i + 1))
+done
+
+for p in $(seq 0 $((processes - 1))); do
+    ls "$work/files" | awk -v p="$p" -v n="$processes" 'NR % n == p' | sed "s|^|$work/files/|" > "$work/shard$p"
+done
+for p in $(seq 0 $((processes - 1))); do
+    next=$(( (p + 1) % processes ))
+    cat "$work/shard$p" "$work/shard$next" > "$work/shared$p"
+    for round in 1 2 3 4; do
+        ls "$work/repeated" | sed "s|^|$work/repeated/|"
+    done > "$work/repeated$p"
+done
+
+now() { date +%s%N; }
+
+# run_writers <repo> <case> <parallel|serial>: prints the elapsed nanoseconds
+run_writers() {
+    mkdir "$1"
+    (cd "$1" && "$server" init > /dev/null && git config gc.auto 0)
+    start=$(now)
+    for p in $(seq 0 $((processes - 1))); do
+        if [ "$3" = parallel ]; then
+            (cd "$1" && "$server" hash-object -w $(cat "$work/$2$p") > "$1.out$p") &
+        else
+            (cd "$1" && "$server" hash-object -w $(cat "$work/$2$p") > "$1.out$p")
+        fi
+    done
+    wait
+    echo $(( $(now) - start ))
+}
+
+status=0
+fail() {
+    echo "FAIL: $*"
+    status=1
+}
+
+# check_store <repo> <case> <source directory>
+check_store() {
+    for p in $(seq 0 $((processes - 1))); do
+        if ! git hash-object $(cat "$work/$2$p") | cmp -s - "$1.out$p"; then
+            fail "$2: process $p printed unexpected hashes"
+        fi
+    done
+
+    if ! (cd "$1" && git fsck --strict > "$1.fsck" 2>&1); then
+        fail "$2: git fsck --strict"
+        cat "$1.fsck"
+    fi
+
+    leftover=$(find "$1/.git/objects" -name 'tmp_obj_*' | wc -l)
+    if [ "$leftover" -ne 0 ]; then
+        fail "$2: $leftover temporary object files left behind"
+    fi
+
+    objects=$(cd "$1" && find .git/objects -type f -path '.git/objects/??/*' | wc -l)
+    distinct=$(cd "$3" && git hash-object -- * | sort -u | wc -l)
+    if [ "$objects" -ne "$distinct" ]; then
+        fail "$2: $objects objects stored, expected $distinct"
+    fi
+}
+
+serial=$(run_writers "$work/serial" shared serial)
+parallel=$(run_writers "$work/parallel" shared parallel)
+check_store "$work/parallel" shared "$work/files"
+
+run_writers "$work/race" repeated parallel > /dev/null
+check_store "$work/race" repeated "$work/repeated"
+
+writes=$((2 * files))
+echo "$processes processes, $writes object writes, $(nproc) cores"
+echo "serial:   $(( writes * 1000000000 / serial )) objects/s"
+echo "parallel: $(( writes * 1000000000 / parallel )) objects/s"
+exit $status
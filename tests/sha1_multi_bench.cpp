@@ -0,0 +1,46 @@
+// Objects per second for sha1Many and the serial SHA1 class on blobs
+// under 4 KiB, the common case for hash-object and write-tree.
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sha1.hpp"
+#include "sha1_multi.hpp"
+#include "test_util.hpp"
+
+
+int main(void) {
+    if (!cpuSupportsBuildTarget())
+        return TEST_SKIPPED;
+
+    const size_t objectCount = 20000;
+    std::mt19937 rng(28);
+    std::vector<std::string> objects;
+    for (size_t i = 0; i < objectCount; i++) {
+        std::string object(rng() % 4096, '\0');
+        for (char& c : object)
+            c = static_cast<char>(rng());
+        objects.push_back(std::move(object));
+    }
+    std::vector<std::string_view> views(objects.begin(), objects.end());
+
+    size_t checksum = 0;
+    double multiSeconds = secondsFor([&]() {
+        checksum += sha1Many(views).size();
+    });
+    double serialSeconds = secondsFor([&]() {
+        for (const std::string& object : objects) {
+            SHA1 hash;
+            hash.update(object);
+            checksum += hash.final().size();
+        }
+    });
+
+    std::printf("sha1_multi_bench [%s, %zu lanes]: sha1Many %.0f objects/s, SHA1 %.0f objects/s, %.2fx (%zu)\n",
+                buildTargetName(), SHA1_MULTI_LANES, objectCount / multiSeconds, objectCount / serialSeconds,
+                serialSeconds / multiSeconds, checksum);
+    return 0;
+}
@@ -0,0 +1,64 @@
+// Checks sha1Many against the serial SHA1 class, at whichever lane count
+// this binary was built for.
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sha1.hpp"
+#include "sha1_multi.hpp"
+#include "test_util.hpp"
+
+
+int main(void) {
+    if (!cpuSupportsBuildTarget())
+        return TEST_SKIPPED;
+
+    std::mt19937 rng(28);
+    std::vector<std::string> messages;
+
+    // Every length around the padding boundaries of the first blocks
+    for (size_t length = 0; length <= 3 * BLOCK_BYTES; length++)
+        messages.push_back(std::string(length, static_cast<char>('a' + length % 26)));
+
+    // Random content and lengths, including some above SHA1_MULTI_MAX_BYTES
+    for (int i = 0; i < 3000; i++) {
+        size_t length = i % 50 == 0 ? rng() % (3 * SHA1_MULTI_MAX_BYTES) : rng() % 4096;
+        std::string message(length, '\0');
+        for (char& c : message)
+            c = static_cast<char>(rng());
+        messages.push_back(std::move(message));
+    }
+
+    std::vector<std::string_view> views(messages.begin(), messages.end());
+    std::vector<std::string> digests = sha1Many(views);
+
+    int failures = 0;
+    for (size_t i = 0; i < messages.size(); i++) {
+        SHA1 hash;
+        hash.update(messages[i]);
+        if (hash.final() != digests[i]) {
+            std::printf("digest mismatch for message %zu (%zu bytes)\n", i, messages[i].size());
+            failures++;
+        }
+    }
+
+    // Batches that only partly fill the lanes
+    for (size_t count = 0; count <= 2 * SHA1_MULTI_LANES + 1; count++) {
+        std::vector<std::string_view> batch(views.begin() + 100, views.begin() + 100 + count);
+        std::vector<std::string> batchDigests = sha1Many(batch);
+        for (size_t i = 0; i < count; i++) {
+            if (batchDigests[i] != digests[100 + i]) {
+                std::printf("digest mismatch in a batch of %zu\n", count);
+                failures++;
+                break;
+            }
+        }
+    }
+
+    std::printf("sha1_multi_test [%s, %zu lanes]: %s\n", buildTargetName(), SHA1_MULTI_LANES,
+                failures == 0 ? "ok" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+# startup_latency.sh - invocations per second of `cat-file -p` on a small blob
+#
+# Usage: startup_latency.sh <server binary>... [-n <invocations>]
+#
+# Each binary is run the given number of times against a one-line blob in a
+# scratch repository, so the figure is dominated by process startup.
+
+set -e
+
+invocations=1000
+binaries=""
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -n) invocations="$2"; shift 2 ;;
+        *) binaries="$binaries $(realpath "$1")"; shift ;;
+    esac
+done
+if [ -z "$binaries" ]; then
+    echo "Usage: $0 <server binary>... [-n <invocations>]" >&2
+    exit 2
+fi
+
+repo=$(mktemp -d)
+trap 'rm -rf "$repo"' EXIT
+cd "$repo"
+
+set -- $binaries
+"$1" init > /dev/null
+echo "hello world" > small.txt
+blob=$("$1" hash-object -w small.txt)
+
+now() { date +%s%N; }
+
+for binary in $binaries; do
+    "$binary" cat-file -p "$blob" > /dev/null   # Warm the page cache
+    start=$(now)
+    i=0
+    while [ $i -lt "$invocations" ]; do
+        "$binary" cat-file -p "$blob" > /dev/null
+        i=$((i + 1))
+    done
+    elapsed=$(( $(now) - start ))
+    printf '%-50s %8d invocations/s  (%d us each)\n' "$binary" \
+        $(( invocations * 1000000000 / elapsed )) $(( elapsed / invocations / 1000 ))
+done
@@ -0,0 +1,94 @@
+/*
+    test_util.hpp - shared helpers for the kernel tests and benchmarks
+
+    The tests are built once per instruction set level (see
+    tests/CMakeLists.txt). A binary built for a level the CPU lacks exits
+    with TEST_SKIPPED instead of failing on an illegal instruction.
+*/
+
+#ifndef TEST_UTIL_HPP
+#define TEST_UTIL_HPP
+
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "byte_scan.hpp"
+
+
+inline constexpr int TEST_SKIPPED = 77;
+
+// True if this CPU can run the instruction set the binary was built for
+inline bool cpuSupportsBuildTarget(void) {
+#if defined(__AVX512F__)
+    return __builtin_cpu_supports("avx512f");
+#elif defined(__AVX2__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return true;
+#endif
+}
+
+inline const char* buildTargetName(void) {
+#if defined(__AVX512F__)
+    return "avx512f";
+#elif defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+template <class F>
+double secondsFor(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Reference tree parser: one std::string::find per token, no block scanning
+inline std::vector<TreeEntryRecord> findTreeEntries(const std::string& tree) {
+    std::vector<TreeEntryRecord> entries;
+    size_t pos = 0;
+    while (pos < tree.size()) {
+        size_t space = tree.find(' ', pos);
+        uint32_t mode = static_cast<uint32_t>(std::stoul(tree.substr(pos, space - pos), nullptr, 8));
+        size_t nullPos = tree.find('\0', space + 1);
+        entries.push_back({mode,
+                           static_cast<uint32_t>(space + 1),
+                           static_cast<uint32_t>(nullPos - space - 1),
+                           static_cast<uint32_t>(nullPos + 1)});
+        pos = nullPos + 1 + TREE_ENTRY_ID_BYTES;
+    }
+    return entries;
+}
+
+// Random tree content. Object ids are biased towards ' ' and '\0' bytes so
+// they look like separators to a scanner that doesn't skip them.
+inline std::string randomTree(std::mt19937& rng, size_t maxEntries) {
+    static const char* modes[] = {"40000", "100644", "100755", "120000", "160000"};
+    std::string tree;
+    size_t entries = rng() % (maxEntries + 1);
+    for (size_t i = 0; i < entries; i++) {
+        tree += modes[rng() % 5];
+        tree += ' ';
+        size_t nameLength = 1 + rng() % 100;
+        for (size_t j = 0; j < nameLength; j++)
+            tree += static_cast<char>('!' + rng() % 94);
+        tree += '\0';
+        for (size_t j = 0; j < TREE_ENTRY_ID_BYTES; j++) {
+            uint32_t r = rng() % 8;
+            tree += r == 0 ? '\0' : r == 1 ? ' ' : static_cast<char>(rng());
+        }
+    }
+    return tree;
+}
+
+
+#endif /* TEST_UTIL_HPP */